@@ -1,19 +1,49 @@
+#include <new>
 #include "cache.h"
 #include "math.h"
 
-Cache::Cache(uint32_t blk_size_p, uint32_t cache_size_p, uint32_t assoc_p){
+Cache::Cache(uint32_t blk_size_p, uint32_t cache_size_p, uint32_t assoc_p, bool compact_state_p){
     block_size = blk_size_p;
     cache_size = cache_size_p;
     associativity = assoc_p;
+    compact_state = compact_state_p;
     next_mem_hier = nullptr;
+    cache = nullptr;
+    set_slot = nullptr;
+    set_words = nullptr;
     initialize_cache_params();
     //do not generate cache if cache size = 0
     if (cache_size != 0){
         calc_cache_properties();
-        generate_cache();
+        if (compact_state == true)
+            generate_compact_cache();
+        else
+            generate_cache();
     }
 }
 
+Cache::~Cache(){
+    if (cache != nullptr)
+    {
+        for (uint32_t rows = 0; rows < number_of_sets; rows++)
+        {
+            delete[] cache[rows];
+        }
+        delete[] cache;
+    }
+    free(set_slot);
+    if (stream_buffer != nullptr)
+    {
+        for (uint32_t rows = 0; rows < number_of_stream_buffers; rows++)
+        {
+            delete[] stream_buffer[rows].ptr_to_stream_buffer;
+        }
+        delete[] stream_buffer;
+    }
+    delete[] victim_cache;
+    delete miss_classifier;
+}
+
 void Cache::calc_cache_properties(){
     //get the number of sets
     number_of_sets = cache_size/(block_size * associativity);
@@ -40,10 +70,21 @@ uint32_t Cache::get_index(uint32_t addr){
 void Cache::generate_cache(){
     //create the cache 
     //dynamically allocate cache with rows = number of sets
-    cache = new cache_with_radio_bits_t*[number_of_sets];
+    cache = new cache_with_radio_bits_t*[number_of_sets]();
     //loop through each row and dynamically allocate the columns = associativity
-    for (uint32_t rows = 0; rows < number_of_sets; rows++){
-        cache[rows] = new cache_with_radio_bits_t[associativity];
+    //the destructor does not run when the constructor throws, so free the rows here
+    try {
+        for (uint32_t rows = 0; rows < number_of_sets; rows++){
+            cache[rows] = new cache_with_radio_bits_t[associativity];
+        }
+    }
+    catch (std::bad_alloc&) {
+        for (uint32_t rows = 0; rows < number_of_sets; rows++){
+            delete[] cache[rows];
+        }
+        delete[] cache;
+        cache = nullptr;
+        throw;
     }
 
     //initialize the memory with 0 and assign the radio flags
@@ -61,6 +102,35 @@ void Cache::generate_cache(){
     }
 }
 
+void Cache::generate_compact_cache(){
+    //bits required to represent lru counter 0..associativity-1
+    lru_bits = 0;
+    while ((1u << lru_bits) < associativity) lru_bits++;
+    way_bits = 2 + lru_bits + tag_bits;
+    words_per_set = (associativity * way_bits + 63) / 64;
+
+    //calloc'd memory is mapped lazily by the OS, so untouched sets do not
+    //add to the resident size. Sets are allocated in the pool on first request
+    //failures are thrown like the ones of new, the caller decides how to report them
+    set_slot = (uint32_t*)calloc(number_of_sets, sizeof(uint32_t));
+    if (set_slot == NULL) throw std::bad_alloc();
+}
+
+uint64_t* Cache::materialize_set(uint32_t index){
+    if (set_slot[index] == 0)
+    {
+        //all ways start invalid and clean with the MRU -> LRU order of generate_cache
+        compact_pool.resize(compact_pool.size() + words_per_set, 0);
+        set_slot[index] = compact_pool.size() / words_per_set;
+        set_words = &compact_pool[(uint64_t)(set_slot[index] - 1) * words_per_set];
+        for (uint32_t colms = 0; colms < associativity; colms++)
+        {
+            set_way_field(colms, 2, lru_bits, colms);
+        }
+    }
+    return &compact_pool[(uint64_t)(set_slot[index] - 1) * words_per_set];
+}
+
 void Cache::generate_stream_buffer(uint32_t number_of_stream_buffers, uint32_t depth_of_stream_buffer){
 
     //assign the class variables
@@ -88,6 +158,25 @@ void Cache::generate_stream_buffer(uint32_t number_of_stream_buffers, uint32_t d
     }
 }
 
+void Cache::generate_victim_cache(uint32_t number_of_victim_blocks){
+    this->number_of_victim_blocks = number_of_victim_blocks;
+
+    //all the blocks start invalid with MRU -> LRU order like the cache sets
+    victim_cache = new cache_with_radio_bits_t[number_of_victim_blocks];
+    for (uint32_t colms = 0; colms < number_of_victim_blocks; colms++)
+    {
+        victim_cache[colms].memory_block = 0;
+        victim_cache[colms].dirty_flag = 0;
+        victim_cache[colms].valid_flag = 0;
+        victim_cache[colms].lru_counter = colms;
+    }
+}
+
+void Cache::generate_miss_classifier(){
+    //shadow fully associative cache with the same number of blocks
+    miss_classifier = new MissClassifier(number_of_sets * associativity);
+}
+
 void Cache::initialize_cache_params(){
 
     //initialize the cache measurements with 0
@@ -98,6 +187,11 @@ void Cache::initialize_cache_params(){
     cache_measurements.miss_rate = 0;
     cache_measurements.write_backs = 0;
     cache_measurements.prefetches = 0;
+    cache_measurements.compulsory_misses = 0;
+    cache_measurements.capacity_misses = 0;
+    cache_measurements.conflict_misses = 0;
+    cache_measurements.swap_requests = 0;
+    cache_measurements.swaps = 0;
 }
 
 bool Cache::is_cache_miss(uint32_t tag, uint32_t index){
@@ -107,7 +201,7 @@ bool Cache::is_cache_miss(uint32_t tag, uint32_t index){
     for (uint32_t column = 0; column < associativity; column++)
     {
         //check if the address is present and valid flag = 1 for a hit
-        if ((cache[index][column].memory_block == tag) && (cache[index][column].valid_flag == 1)) {
+        if ((get_memory_block(index, column) == tag) && is_valid(index, column)) {
             //return false if it hits
             miss = false;
             //do not iterate once memory block is found
@@ -257,6 +351,103 @@ void Cache::update_stream_buffer(bool cache_miss, bool stb_miss, uint32_t addr)
     }
 }
 
+//move the victim cache block to the new lru position
+//0 -> MRU, number_of_victim_blocks-1 -> LRU
+void Cache::update_victim_cache_lru(uint32_t block, uint32_t lru_count)
+{
+    uint32_t old_lru_count = victim_cache[block].lru_counter;
+    for (uint32_t colms = 0; colms < number_of_victim_blocks; colms++)
+    {
+        //blocks between the old and the new position shift by one
+        if ((lru_count < old_lru_count) && (victim_cache[colms].lru_counter >= lru_count) && (victim_cache[colms].lru_counter < old_lru_count))
+            victim_cache[colms].lru_counter += 1;
+        else if ((lru_count > old_lru_count) && (victim_cache[colms].lru_counter > old_lru_count) && (victim_cache[colms].lru_counter <= lru_count))
+            victim_cache[colms].lru_counter -= 1;
+    }
+    victim_cache[block].lru_counter = lru_count;
+}
+
+//handle a cache miss with the victim cache between this cache and the next hierarchy
+//the block evicted from the set moves into the victim cache. On a victim cache hit
+//the requested block is swapped into the set instead of being read from the next hierarchy
+//returns true if the block swapped into the set is dirty
+bool Cache::access_victim_cache(uint32_t addr, uint32_t index, uint32_t way, bool stb_miss)
+{
+    uint32_t requested_block = addr >> block_offset_bits;
+    //the block being evicted from the set
+    bool evicted_valid = is_valid(index, way);
+    bool evicted_dirty = is_dirty(index, way);
+    uint32_t evicted_block = (get_memory_block(index, way) << index_bits) | index;
+    //the dirty state moves to the victim cache together with the block
+    set_dirty(index, way, 0);
+
+    //misses served by the stream buffer are not counted as misses
+    if (stb_miss == true)
+        cache_measurements.swap_requests += 1;
+
+    //look for the requested block
+    uint32_t entry = number_of_victim_blocks;
+    for (uint32_t colms = 0; colms < number_of_victim_blocks; colms++)
+    {
+        if ((victim_cache[colms].valid_flag == 1) && (victim_cache[colms].memory_block == requested_block))
+        {
+            entry = colms;
+            break;
+        }
+    }
+
+    bool swapped_in_dirty = false;
+    bool victim_cache_hit = (entry != number_of_victim_blocks);
+    if (victim_cache_hit == true)
+    {
+        //hit -> the requested block and the evicted block trade places
+        if (stb_miss == true)
+            cache_measurements.swaps += 1;
+        swapped_in_dirty = (victim_cache[entry].dirty_flag == 1);
+    }
+    else
+    {
+        //miss -> the evicted block replaces the LRU block of the victim cache
+        for (uint32_t colms = 0; colms < number_of_victim_blocks; colms++)
+        {
+            if (victim_cache[colms].lru_counter == (number_of_victim_blocks-1))
+            {
+                entry = colms;
+                break;
+            }
+        }
+        if ((evicted_valid == true) && (victim_cache[entry].valid_flag == 1) && (victim_cache[entry].dirty_flag == 1))
+        {
+            cache_measurements.write_backs += 1;
+            if (next_mem_hier != nullptr)
+            {
+                next_mem_hier->request(victim_cache[entry].memory_block << block_offset_bits,'w');
+            }
+        }
+        if (next_mem_hier != nullptr)
+        {
+            //bring the memory block from lower hierarchy
+            next_mem_hier->request(addr,'r');
+        }
+    }
+
+    if (evicted_valid == true)
+    {
+        victim_cache[entry].valid_flag = 1;
+        victim_cache[entry].dirty_flag = evicted_dirty ? 1 : 0;
+        victim_cache[entry].memory_block = evicted_block;
+        update_victim_cache_lru(entry, 0);
+    }
+    else if (victim_cache_hit == true)
+    {
+        //the block moved into a free way of the set, nothing comes back
+        victim_cache[entry].valid_flag = 0;
+        victim_cache[entry].dirty_flag = 0;
+        update_victim_cache_lru(entry, number_of_victim_blocks-1);
+    }
+    return swapped_in_dirty;
+}
+
 void Cache::evict_and_update_lru(uint32_t tag, uint32_t lru_count_to_replace, uint32_t index,char r_w){
     //in the cache perform the eviction and update the lru counters
     
@@ -265,22 +456,23 @@ void Cache::evict_and_update_lru(uint32_t tag, uint32_t lru_count_to_replace, ui
     { 
         //increment the lru_counter if lesser than the lru_counter of value
         //of the required memory block
-        if(cache[index][colms].lru_counter < lru_count_to_replace)
+        uint32_t lru_counter = get_lru_counter(index, colms);
+        if(lru_counter < lru_count_to_replace)
         {
-            cache[index][colms].lru_counter += 1;
+            set_lru_counter(index, colms, lru_counter + 1);
         }
         //reset the lru counter to 0, if it hits the required count
         //this indicates the requested memory block is MRU
-        else if(cache[index][colms].lru_counter == lru_count_to_replace)
+        else if(lru_counter == lru_count_to_replace)
         {
-            cache[index][colms].lru_counter = 0;
-            cache[index][colms].memory_block = tag;
+            set_lru_counter(index, colms, 0);
+            set_memory_block(index, colms, tag);
             //update the valid flag
-            cache[index][colms].valid_flag = 1;
+            set_valid(index, colms, 1);
             //update the radio flags based on r/w
             if (r_w == 'w')
             {
-                cache[index][colms].dirty_flag = 1;
+                set_dirty(index, colms, 1);
             }
         }
         //keep the value of lru_counter same for counter values greater than 
@@ -309,6 +501,17 @@ void Cache::request(uint32_t addr, char r_w)
     
     bool stb_exists = (stream_buffer != nullptr) ? true : false;
     bool stb_miss = true;
+    //the way replaced on a miss and whether the block swapped in from the victim cache is dirty
+    uint32_t victim_way = 0;
+    bool swapped_in_dirty = false;
+
+    //every request updates the shadow cache, the class is only counted on a miss
+    miss_type_t miss_type = MISS_CONFLICT;
+    if (miss_classifier != nullptr)
+        miss_type = miss_classifier->access(addr >> block_offset_bits);
+
+    //every request updates its set, so the compact state allocates it here once
+    select_set(index);
 
     //check if the memory blocks misses in cache
     miss = is_cache_miss(tag = tag, index = index);
@@ -340,33 +543,53 @@ void Cache::request(uint32_t addr, char r_w)
                cache_measurements.write_misses += 1;
             else
                 cache_measurements.read_misses +=1;
+
+            if (miss_classifier != nullptr)
+            {
+                if (miss_type == MISS_COMPULSORY)
+                    cache_measurements.compulsory_misses += 1;
+                else if (miss_type == MISS_CAPACITY)
+                    cache_measurements.capacity_misses += 1;
+                else
+                    cache_measurements.conflict_misses += 1;
+            }
         }
         
         //get the column whose lru_counter = associativity - 1
         for (uint32_t colm =0; colm < associativity; colm++)
+        {
+            if (get_lru_counter(index, colm) == (associativity-1))
+            {
+                victim_way = colm;
+                break;
+            }
+        }
+
+        //the victim cache decides what reaches the lower hierarchy
+        if (victim_cache != nullptr)
+        {
+            swapped_in_dirty = access_victim_cache(addr, index, victim_way, stb_miss);
+        }
+        else
         {
             //check before eviction, if the memory block at LRU was dirty
             //dirty = 1 -> write back to main memory
-            if (cache[index][colm].lru_counter == (associativity-1))
+            if (is_dirty(index, victim_way))
             {
-                if (cache[index][colm].dirty_flag == 1)
+                cache_measurements.write_backs += 1;
+                if (next_mem_hier != nullptr)
                 {
-                    cache_measurements.write_backs += 1;
-                    if (next_mem_hier != nullptr)
-                    {
-                        //send the address of the block to next mem that is being evicted
-                        addr_to_be_evicted = get_addr_from_tag_index(cache[index][colm].memory_block,index);
-                        next_mem_hier->request(addr_to_be_evicted,'w');
-                    }
-                    cache[index][colm].dirty_flag = 0;
+                    //send the address of the block to next mem that is being evicted
+                    addr_to_be_evicted = get_addr_from_tag_index(get_memory_block(index, victim_way),index);
+                    next_mem_hier->request(addr_to_be_evicted,'w');
                 }
-                break;
+                set_dirty(index, victim_way, 0);
+            }
+            if (next_mem_hier != nullptr)
+            {
+                //bring the memory block from  lower hierarchy irrespective of dirty flag
+                next_mem_hier->request(addr,'r');
             }
-        }
-        if (next_mem_hier != nullptr)
-        {
-            //bring the memory block from  lower hierarchy irrespective of dirty flag
-            next_mem_hier->request(addr,'r');
         }
         lru_count_to_be_evicted = associativity-1;
     }
@@ -376,28 +599,33 @@ void Cache::request(uint32_t addr, char r_w)
         //get the lru counter value of current hit block
         for (uint32_t colms=0; colms < associativity; colms++)
         {
-            if (cache[index][colms].memory_block == tag){
-                lru_count_to_be_evicted = cache[index][colms].lru_counter;
+            if (get_memory_block(index, colms) == tag){
+                lru_count_to_be_evicted = get_lru_counter(index, colms);
             }
         }
     }
     //no explicit read issued to memory in the simulator for miss/hit
     //update the memory block and LRU with the new block based on the r/w request
     evict_and_update_lru(tag,lru_count_to_be_evicted,index, r_w);
-    
+    //a dirty block swapped in from the victim cache stays dirty
+    if (swapped_in_dirty == true)
+        set_dirty(index, victim_way, 1);
 }
 
 //print the cache contents from MRU to LRU order
-void Cache::print_cache_contents()
+void Cache::print_cache_contents(FILE* out)
 {
     for (uint32_t set=0; set < number_of_sets; set++)
     {
+        //sets never allocated in the compact state hold no valid block
+        if ((compact_state == true) && (set_slot[set] == 0)) continue;
+        select_set(set);
         //a set is invalid if all the memory blocks are invalid
         bool set_invalid = true;
         //check if the set has atleast 1 way valid
         for (uint32_t colm=0; colm < associativity; colm++)
         {
-            if (cache[set][colm].valid_flag == 1)
+            if (is_valid(set, colm))
             {
                 set_invalid = false;
                 //no need to iterate through rest of the colms
@@ -407,7 +635,7 @@ void Cache::print_cache_contents()
         //if set is valid then print the set
         if (set_invalid == false)
         {
-            printf("set     %2u: ",set);
+            fprintf(out, "set     %2u: ",set);
         }
         //else skip the value of the set in loop. Do not print anything
         else
@@ -422,26 +650,43 @@ void Cache::print_cache_contents()
             for (uint32_t colm = 0; colm < associativity; colm++)
             {
                 //print based on recency
-                if ((cache[set][colm].lru_counter == lru_count) &&
-                    (cache[set][colm].valid_flag == 1))
+                if ((get_lru_counter(set, colm) == lru_count) &&
+                    is_valid(set, colm))
                 {
                     //check if the bit is dirty
-                    if (cache[set][colm].dirty_flag == 1){
-                        printf("  %x D",cache[set][colm].memory_block);
+                    if (is_dirty(set, colm)){
+                        fprintf(out, "  %x D",get_memory_block(set, colm));
                     }
                     else{
-                        printf("  %x  ",cache[set][colm].memory_block);
+                        fprintf(out, "  %x  ",get_memory_block(set, colm));
                     }
                     break;
                 }
             }
         }
-        printf("\n");
+        fprintf(out, "\n");
     }
     //TODO: Delete the cache after printing contents
 }
 
-void Cache::print_stream_buffer_contents(){
+void Cache::print_victim_cache_contents(FILE* out){
+    //print the valid blocks based on recency order MRU -> LRU
+    for (uint32_t lru_count = 0; lru_count < number_of_victim_blocks; lru_count++)
+    {
+        for (uint32_t colms = 0; colms < number_of_victim_blocks; colms++)
+        {
+            if ((victim_cache[colms].lru_counter != lru_count) || (victim_cache[colms].valid_flag == 0)) continue;
+            if (victim_cache[colms].dirty_flag == 1)
+                fprintf(out, "  %x D",victim_cache[colms].memory_block);
+            else
+                fprintf(out, "  %x  ",victim_cache[colms].memory_block);
+            break;
+        }
+    }
+    fprintf(out, "\n");
+}
+
+void Cache::print_stream_buffer_contents(FILE* out){
     //print the contents based on recency order MRU -> LRU
     for (uint32_t lru_count = 0; lru_count < number_of_stream_buffers; lru_count++)
     {
@@ -454,9 +699,9 @@ void Cache::print_stream_buffer_contents(){
             if (stream_buffer[rows].valid_flag == 0) break;
             for(uint32_t colms = 0; colms < depth_of_stream_buffer; colms++)
             {
-                printf(" %x ",stream_buffer[rows].ptr_to_stream_buffer[colms]);
+                fprintf(out, " %x ",stream_buffer[rows].ptr_to_stream_buffer[colms]);
             }
-            printf("\n");
+            fprintf(out, "\n");
         }
     }
 }
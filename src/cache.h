@@ -4,7 +4,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <vector>
 #include "sim.h"
+#include "miss_classifier.h"
 
 
 //radio bits associated with each memory block in cache
@@ -28,6 +30,13 @@ typedef struct
     float miss_rate;
     uint32_t write_backs;
     uint32_t prefetches;
+    //3C breakdown of the read and write misses (miss classification only)
+    uint32_t compulsory_misses;
+    uint32_t capacity_misses;
+    uint32_t conflict_misses;
+    //misses looked up in / served by the victim cache (victim cache only)
+    uint32_t swap_requests;
+    uint32_t swaps;
 } cache_measurements_t;
 
 //stream buffer associated with cache
@@ -53,6 +62,9 @@ class Cache {
         //stream buffer properties
         uint32_t depth_of_stream_buffer;
         uint32_t number_of_stream_buffers;
+
+        //victim cache properties
+        uint32_t number_of_victim_blocks;
         
         //cache properties
         uint32_t number_of_sets; //number of sets associated to cache
@@ -60,6 +72,100 @@ class Cache {
         uint32_t index_bits;     //number of bits used for index
         uint32_t block_offset_bits; //number of bits used for block offset
 
+        //compact state properties
+        //each way is packed as [valid | dirty | lru (lru_bits) | tag (tag_bits)]
+        //and sets are only allocated on their first request
+        bool compact_state;
+        uint32_t lru_bits;          //bits required to represent the lru counter
+        uint32_t way_bits;          //bits used by a single way
+        uint32_t words_per_set;     //64 bit words used by a single set
+        uint32_t* set_slot;         //1 based slot of the set in compact_pool, 0 -> not allocated
+        std::vector<uint64_t> compact_pool; //packed storage of the allocated sets
+
+        uint64_t* set_words;        //words of the set selected by select_set()
+
+        void generate_compact_cache();
+        uint64_t* materialize_set(uint32_t);
+
+        //resolve the storage of a set once per request, the accessors below
+        //then work on set_words without looking the set up again
+        void select_set(uint32_t index)
+        {
+            if (compact_state == true) set_words = materialize_set(index);
+        }
+
+        //read/write a field of a way in the selected compact set
+        uint32_t get_way_field(uint32_t way, uint32_t lsb, uint32_t width)
+        {
+            if (width == 0) return 0;
+            uint64_t bit = (uint64_t)way * way_bits + lsb;
+            uint32_t shift = bit & 63;
+            uint64_t value = set_words[bit >> 6] >> shift;
+            //field crosses into the next word
+            if (shift + width > 64)
+                value |= set_words[(bit >> 6) + 1] << (64 - shift);
+            return (uint32_t)(value & ((1ull << width) - 1));
+        }
+        void set_way_field(uint32_t way, uint32_t lsb, uint32_t width, uint32_t value)
+        {
+            if (width == 0) return;
+            uint64_t bit = (uint64_t)way * way_bits + lsb;
+            uint32_t shift = bit & 63;
+            uint64_t mask = (1ull << width) - 1;
+            uint64_t field = (uint64_t)value & mask;
+            set_words[bit >> 6] = (set_words[bit >> 6] & ~(mask << shift)) | (field << shift);
+            //field crosses into the next word
+            if (shift + width > 64)
+            {
+                uint32_t low_bits = 64 - shift;
+                set_words[(bit >> 6) + 1] = (set_words[(bit >> 6) + 1] & ~(mask >> low_bits)) | (field >> low_bits);
+            }
+        }
+
+        //accessors for the radio bits and memory block of a given set/way
+        //work on both the regular and the compact cache state
+        //in the compact state the set must have been selected with select_set()
+        bool is_valid(uint32_t index, uint32_t way)
+        {
+            if (compact_state == false) return cache[index][way].valid_flag == 1;
+            return get_way_field(way, 0, 1) == 1;
+        }
+        bool is_dirty(uint32_t index, uint32_t way)
+        {
+            if (compact_state == false) return cache[index][way].dirty_flag == 1;
+            return get_way_field(way, 1, 1) == 1;
+        }
+        uint32_t get_lru_counter(uint32_t index, uint32_t way)
+        {
+            if (compact_state == false) return cache[index][way].lru_counter;
+            return get_way_field(way, 2, lru_bits);
+        }
+        uint32_t get_memory_block(uint32_t index, uint32_t way)
+        {
+            if (compact_state == false) return cache[index][way].memory_block;
+            return get_way_field(way, 2 + lru_bits, tag_bits);
+        }
+        void set_valid(uint32_t index, uint32_t way, uint32_t value)
+        {
+            if (compact_state == false) cache[index][way].valid_flag = value;
+            else set_way_field(way, 0, 1, value);
+        }
+        void set_dirty(uint32_t index, uint32_t way, uint32_t value)
+        {
+            if (compact_state == false) cache[index][way].dirty_flag = value;
+            else set_way_field(way, 1, 1, value);
+        }
+        void set_lru_counter(uint32_t index, uint32_t way, uint32_t value)
+        {
+            if (compact_state == false) cache[index][way].lru_counter = value;
+            else set_way_field(way, 2, lru_bits, value);
+        }
+        void set_memory_block(uint32_t index, uint32_t way, uint32_t value)
+        {
+            if (compact_state == false) cache[index][way].memory_block = value;
+            else set_way_field(way, 2 + lru_bits, tag_bits, value);
+        }
+
     public:
 
         //2d array that emulates the cache of size #sets x Associativity
@@ -73,15 +179,25 @@ class Cache {
         //stream buffer storing the prefetched address
         stream_buffer_t* stream_buffer = nullptr;
 
+        //fully associative victim cache holding the blocks evicted from this cache
+        //memory_block stores the block address (address >> block offset bits)
+        cache_with_radio_bits_t* victim_cache = nullptr;
+
+        //shadow fully associative cache classifying the misses of this cache
+        MissClassifier* miss_classifier = nullptr;
+
         //------Function definitions------//
 
         //parameterized constructor
-        //passing blocksize, cache size and associativity
-        Cache(uint32_t, uint32_t, uint32_t);
+        //passing blocksize, cache size, associativity and whether the compact state is used
+        Cache(uint32_t, uint32_t, uint32_t, bool = false);
+        //release the cache, stream buffer, victim cache and classifier
+        ~Cache();
 
         //print the contents of stream buffer and cache
-        void print_stream_buffer_contents();
-        void print_cache_contents();
+        void print_stream_buffer_contents(FILE*);
+        void print_cache_contents(FILE*);
+        void print_victim_cache_contents(FILE*);
  
         //calculates all the cache properties 
         void calc_cache_properties();
@@ -97,10 +213,14 @@ class Cache {
         //initialize the cache with default values
         void generate_cache();
         void generate_stream_buffer(uint32_t, uint32_t);
+        void generate_victim_cache(uint32_t);
+        void generate_miss_classifier();
 
         //handle the request from the upper level -> CPU/upper cache
         void request(uint32_t, char);
         void update_stream_buffer(bool, bool, uint32_t);
+        bool access_victim_cache(uint32_t, uint32_t, uint32_t, bool);
+        void update_victim_cache_lru(uint32_t, uint32_t);
 
         //check for misses in cache/stream buffer
         bool is_cache_miss(uint32_t, uint32_t);
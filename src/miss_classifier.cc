@@ -0,0 +1,132 @@
+#include <new>
+#include "miss_classifier.h"
+
+//special values of entry_t::node and the list links
+#define EMPTY        0xFFFFFFFFu //unused hash table entry / end of the list
+#define NOT_RESIDENT 0xFFFFFFFEu //block was referenced but is not in the shadow cache
+
+MissClassifier::MissClassifier(uint32_t capacity_p){
+    capacity = capacity_p;
+
+    //start with room for twice the blocks of the shadow cache
+    table_bits = 4;
+    while ((1u << table_bits) < 2 * capacity) table_bits++;
+    table = new entry_t[1u << table_bits];
+    for (uint32_t i = 0; i < (1u << table_bits); i++)
+    {
+        table[i].node = EMPTY;
+    }
+    table_used = 0;
+
+    //the destructor does not run when the constructor throws
+    try {
+        nodes = new node_t[capacity];
+    }
+    catch (std::bad_alloc&) {
+        delete[] table;
+        throw;
+    }
+    nodes_used = 0;
+    head = EMPTY;
+    tail = EMPTY;
+}
+
+MissClassifier::~MissClassifier(){
+    delete[] table;
+    delete[] nodes;
+}
+
+//returns the entry of the block, or the empty entry where it would be inserted
+MissClassifier::entry_t* MissClassifier::find(uint32_t block){
+    uint32_t mask = (1u << table_bits) - 1;
+    //fibonacci hashing, linear probing
+    uint32_t slot = (uint32_t)((block * 0x9E3779B97F4A7C15ull) >> (64 - table_bits));
+    while ((table[slot].node != EMPTY) && (table[slot].block != block))
+    {
+        slot = (slot + 1) & mask;
+    }
+    return &table[slot];
+}
+
+void MissClassifier::grow_table(){
+    entry_t* old_table = table;
+    uint32_t old_size = 1u << table_bits;
+
+    //the old table is kept as is when the allocation throws
+    table = new entry_t[2 * old_size];
+    table_bits++;
+    for (uint32_t i = 0; i < (1u << table_bits); i++)
+    {
+        table[i].node = EMPTY;
+    }
+    for (uint32_t i = 0; i < old_size; i++)
+    {
+        if (old_table[i].node == EMPTY) continue;
+        entry_t* entry = find(old_table[i].block);
+        *entry = old_table[i];
+        //resident blocks follow their entry to the new slot
+        if (entry->node != NOT_RESIDENT) nodes[entry->node].slot = entry - table;
+    }
+    delete[] old_table;
+}
+
+void MissClassifier::unlink(uint32_t node){
+    if (nodes[node].prev != EMPTY) nodes[nodes[node].prev].next = nodes[node].next;
+    else head = nodes[node].next;
+    if (nodes[node].next != EMPTY) nodes[nodes[node].next].prev = nodes[node].prev;
+    else tail = nodes[node].prev;
+}
+
+void MissClassifier::push_front(uint32_t node){
+    nodes[node].prev = EMPTY;
+    nodes[node].next = head;
+    if (head != EMPTY) nodes[head].prev = node;
+    else tail = node;
+    head = node;
+}
+
+miss_type_t MissClassifier::access(uint32_t block){
+    entry_t* entry = find(block);
+
+    //hit in the shadow cache -> only update the recency
+    if ((entry->node != EMPTY) && (entry->node != NOT_RESIDENT))
+    {
+        if (entry->node != head)
+        {
+            unlink(entry->node);
+            push_front(entry->node);
+        }
+        return MISS_CONFLICT;
+    }
+
+    miss_type_t type = (entry->node == EMPTY) ? MISS_COMPULSORY : MISS_CAPACITY;
+
+    //pick a free node or evict the LRU block of the shadow cache
+    uint32_t node;
+    if (nodes_used < capacity)
+    {
+        node = nodes_used++;
+    }
+    else
+    {
+        node = tail;
+        unlink(node);
+        table[nodes[node].slot].node = NOT_RESIDENT;
+    }
+    push_front(node);
+
+    if (type == MISS_COMPULSORY)
+    {
+        //keep the load factor at or below 1/2
+        if (2 * (table_used + 1) > (1u << table_bits))
+        {
+            grow_table();
+            entry = find(block);
+        }
+        entry->block = block;
+        table_used++;
+    }
+    entry->node = node;
+    nodes[node].slot = entry - table;
+    return type;
+}
@@ -0,0 +1,62 @@
+#ifndef MISS_CLASSIFIER_H
+#define MISS_CLASSIFIER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+//reason of a miss in the 3C model
+typedef enum
+{
+    MISS_COMPULSORY, //first reference to the block
+    MISS_CAPACITY,   //also misses in a fully associative LRU cache of equal capacity
+    MISS_CONFLICT    //hits in the fully associative cache -> caused by the set mapping
+} miss_type_t;
+
+//shadow fully associative LRU cache plus the set of blocks ever referenced
+//both share one open addressing hash table: block -> node in the LRU list
+class MissClassifier {
+    private:
+        //hash table entry
+        typedef struct
+        {
+            uint32_t block; //block number (address >> block offset bits)
+            uint32_t node;  //node of the block in the LRU list, NOT_RESIDENT or EMPTY
+        } entry_t;
+
+        uint32_t capacity;        //number of blocks in the shadow cache
+
+        entry_t* table;
+        uint32_t table_bits;      //table holds 2^table_bits entries
+        uint32_t table_used;      //number of blocks ever referenced
+
+        //node of the doubly linked LRU list, head -> MRU, tail -> LRU
+        typedef struct
+        {
+            uint32_t slot;  //hash table entry of the block
+            uint32_t prev;
+            uint32_t next;
+        } node_t;
+
+        node_t* nodes;
+        uint32_t nodes_used;
+        uint32_t head;
+        uint32_t tail;
+
+        entry_t* find(uint32_t);
+        void grow_table();
+        void unlink(uint32_t);
+        void push_front(uint32_t);
+
+    public:
+        //parameterized constructor
+        //passing the number of blocks of the cache being classified
+        MissClassifier(uint32_t);
+        ~MissClassifier();
+
+        //reference the block in the shadow cache and return the class the
+        //miss would have if the real cache missed
+        miss_type_t access(uint32_t);
+};
+
+#endif
@@ -0,0 +1,265 @@
+#include <string.h>
+#include "report.h"
+
+bool parse_output_format(const char* value, output_format_t* format)
+{
+    if (strcmp(value, "text") == 0)
+        *format = OUTPUT_TEXT;
+    else if (strcmp(value, "json") == 0)
+        *format = OUTPUT_JSON;
+    else if (strcmp(value, "csv") == 0)
+        *format = OUTPUT_CSV;
+    else
+        return false;
+    return true;
+}
+
+//print a string inside double quotes, escaped for JSON or for CSV ("" for CSV)
+static void print_quoted(FILE* out, const char* value, bool csv)
+{
+    fputc('"', out);
+    for (const char* c = value; *c != '\0'; c++)
+    {
+        if (*c == '"')
+            fputs(csv ? "\"\"" : "\\\"", out);
+        else if ((*c == '\\') && (csv == false))
+            fputs("\\\\", out);
+        //CSV keeps control characters inside the quotes, JSON strings cannot hold them raw
+        else if ((*c == '\n') && (csv == false))
+            fputs("\\n", out);
+        else if ((*c == '\t') && (csv == false))
+            fputs("\\t", out);
+        else if (((unsigned char)*c < 0x20) && (csv == false))
+            fprintf(out, "\\u%04x", (unsigned char)*c);
+        else
+            fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+//print a counter of an optional feature, preceded by its separator
+//a feature that is off prints null (JSON, name != NULL) or an empty field (CSV, name == NULL)
+//so "not measured" cannot be mistaken for a measured 0
+static void print_optional_counter(FILE* out, const char* name, uint32_t value, bool measured)
+{
+    if (name != NULL)
+        fprintf(out, ",\"%s\":", name);
+    else
+        fputc(',', out);
+    if (measured == true)
+        fprintf(out, "%u", value);
+    else if (name != NULL)
+        fputs("null", out);
+}
+
+Reporter::Reporter(output_format_t format_p, const cache_params_t& params_p, const char* trace_p, Cache* cache_l1_p, Cache* cache_l2_p, FILE* out_p){
+    format = format_p;
+    out = out_p;
+    params = params_p;
+    trace = trace_p;
+    cache_l1 = cache_l1_p;
+    cache_l2 = cache_l2_p;
+    l2_exists = (params.L2_SIZE != 0);
+    stb_exists = (params.PREF_N != 0);
+    csv_header_printed = false;
+}
+
+uint32_t Reporter::update_measurements(){
+    uint32_t memory_traffic = 0;
+    //the last level talks to the main memory
+    Cache* last_level = (l2_exists == true) ? cache_l2 : cache_l1;
+    memory_traffic = last_level->cache_measurements.write_backs + last_level->cache_measurements.read_misses + last_level->cache_measurements.write_misses + last_level->cache_measurements.prefetches;
+    //misses served by the victim cache never reach the memory
+    memory_traffic -= last_level->cache_measurements.swaps;
+
+    //caclulate miss rates
+    //a level without any request yet has a miss rate of 0 instead of nan
+    cache_measurements_t& l1 = cache_l1->cache_measurements;
+    cache_measurements_t& l2 = cache_l2->cache_measurements;
+    if ((l2_exists == true) && (l2.reads != 0))
+    {
+        l2.miss_rate = (float)(l2.read_misses)/(float)(l2.reads);
+    }
+    if ((l1.reads + l1.writes) != 0)
+    {
+        l1.miss_rate = (float)(l1.read_misses + l1.write_misses)/(float)(l1.reads + l1.writes);
+    }
+    return memory_traffic;
+}
+
+void Reporter::print_configuration(){
+    if (format != OUTPUT_TEXT) return;
+    fprintf(out, "===== Simulator configuration =====\n");
+    fprintf(out, "BLOCKSIZE:  %u\n", params.BLOCKSIZE);
+    fprintf(out, "L1_SIZE:    %u\n", params.L1_SIZE);
+    fprintf(out, "L1_ASSOC:   %u\n", params.L1_ASSOC);
+    fprintf(out, "L2_SIZE:    %u\n", params.L2_SIZE);
+    fprintf(out, "L2_ASSOC:   %u\n", params.L2_ASSOC);
+    fprintf(out, "PREF_N:     %u\n", params.PREF_N);
+    fprintf(out, "PREF_M:     %u\n", params.PREF_M);
+    fprintf(out, "trace_file: %s\n", trace);
+    fprintf(out, "\n");
+}
+
+void Reporter::print_contents(FILE* out){
+    fprintf(out, "===== L1 contents =====\n");
+    cache_l1->print_cache_contents(out);
+    if (l2_exists == true)
+    {
+        fprintf(out, "\n");
+        fprintf(out, "===== L2 contents =====\n");
+        cache_l2->print_cache_contents(out);
+    }
+
+    if (cache_l1->victim_cache != nullptr)
+    {
+        fprintf(out, "\n");
+        fprintf(out, "===== Victim Cache contents =====\n");
+        cache_l1->print_victim_cache_contents(out);
+    }
+
+    //check for stream buffer output
+    if (stb_exists == true)
+    {
+        fprintf(out, "\n");
+        fprintf(out, "===== Stream Buffer(s) contents =====\n");
+        //check the hierarchy for which the stream buffer is added
+        if (l2_exists == true)
+        {
+            cache_l2->print_stream_buffer_contents(out);
+        }
+        else
+        {
+            cache_l1->print_stream_buffer_contents(out);
+        }
+    }
+}
+
+void Reporter::print_measurements(const char* record, uint64_t accesses){
+    uint32_t memory_traffic = update_measurements();
+    switch (format)
+    {
+        case OUTPUT_TEXT:
+            print_text_measurements(record, accesses, memory_traffic);
+            break;
+        case OUTPUT_JSON:
+            print_json_record(record, accesses, memory_traffic);
+            break;
+        case OUTPUT_CSV:
+            print_csv_record(record, accesses, memory_traffic);
+            break;
+    }
+    //interval records are consumed while the simulation is still running
+    fflush(out);
+}
+
+void Reporter::print_text_measurements(const char* record, uint64_t accesses, uint32_t memory_traffic){
+    cache_measurements_t& l1 = cache_l1->cache_measurements;
+    cache_measurements_t& l2 = cache_l2->cache_measurements;
+    if (strcmp(record, "final") == 0)
+    {
+        fprintf(out, "\n");
+        fprintf(out, "===== Measurements =====\n");
+    }
+    else
+    {
+        fprintf(out, "===== Measurements (%s, %" PRIu64 " accesses) =====\n", record, accesses);
+    }
+    fprintf(out, "a. L1 reads:                   %u\n",l1.reads);
+    fprintf(out, "b. L1 read misses:             %u\n",l1.read_misses);
+    fprintf(out, "c. L1 writes:                  %u\n",l1.writes);
+    fprintf(out, "d. L1 write misses:            %u\n",l1.write_misses);
+    fprintf(out, "e. L1 miss rate:               %.4f\n",l1.miss_rate);
+    fprintf(out, "f. L1 writebacks:              %u\n",l1.write_backs);
+    fprintf(out, "g. L1 prefetches:              %u\n",l1.prefetches);
+    fprintf(out, "h. L2 reads (demand):          %u\n",l2.reads);
+    fprintf(out, "i. L2 read misses (demand):    %u\n",l2.read_misses);
+    fprintf(out, "j. L2 reads (prefetch):        0\n");
+    fprintf(out, "k. L2 read misses (prefetch):  0\n");
+    fprintf(out, "l. L2 writes:                  %u\n",l2.writes);
+    fprintf(out, "m. L2 write misses:            %u\n",l2.write_misses);
+    fprintf(out, "n. L2 miss rate:               %.4f\n",l2.miss_rate);
+    fprintf(out, "o. L2 writebacks:              %u\n",l2.write_backs);
+    fprintf(out, "p. L2 prefetches:              %u\n",l2.prefetches);
+    fprintf(out, "q. memory traffic:             %u\n",memory_traffic);
+    if (cache_l1->miss_classifier != nullptr)
+    {
+        fprintf(out, "\n");
+        fprintf(out, "===== Miss classification =====\n");
+        fprintf(out, "L1 compulsory misses:          %u\n",l1.compulsory_misses);
+        fprintf(out, "L1 capacity misses:            %u\n",l1.capacity_misses);
+        fprintf(out, "L1 conflict misses:            %u\n",l1.conflict_misses);
+        if (l2_exists == true)
+        {
+            fprintf(out, "L2 compulsory misses:          %u\n",l2.compulsory_misses);
+            fprintf(out, "L2 capacity misses:            %u\n",l2.capacity_misses);
+            fprintf(out, "L2 conflict misses:            %u\n",l2.conflict_misses);
+        }
+    }
+    if (cache_l1->victim_cache != nullptr)
+    {
+        fprintf(out, "\n");
+        fprintf(out, "===== Victim cache =====\n");
+        fprintf(out, "L1 swap requests:              %u\n",l1.swap_requests);
+        fprintf(out, "L1 swaps:                      %u\n",l1.swaps);
+    }
+    //separate the interval blocks from each other
+    if (strcmp(record, "final") != 0) fprintf(out, "\n");
+}
+
+void Reporter::print_json_record(const char* record, uint64_t accesses, uint32_t memory_traffic){
+    cache_measurements_t& l1 = cache_l1->cache_measurements;
+    cache_measurements_t& l2 = cache_l2->cache_measurements;
+    fprintf(out, "{\"record\":\"%s\",\"accesses\":%" PRIu64 ",", record, accesses);
+    fprintf(out, "\"blocksize\":%u,\"l1_size\":%u,\"l1_assoc\":%u,\"l2_size\":%u,\"l2_assoc\":%u,\"pref_n\":%u,\"pref_m\":%u,\"trace\":",
+           params.BLOCKSIZE, params.L1_SIZE, params.L1_ASSOC, params.L2_SIZE, params.L2_ASSOC, params.PREF_N, params.PREF_M);
+    print_quoted(out, trace, false);
+    fprintf(out, ",\"l1_reads\":%u,\"l1_read_misses\":%u,\"l1_writes\":%u,\"l1_write_misses\":%u,\"l1_miss_rate\":%.6f,\"l1_writebacks\":%u,\"l1_prefetches\":%u",
+           l1.reads, l1.read_misses, l1.writes, l1.write_misses, l1.miss_rate, l1.write_backs, l1.prefetches);
+    fprintf(out, ",\"l2_reads\":%u,\"l2_read_misses\":%u,\"l2_prefetch_reads\":0,\"l2_prefetch_read_misses\":0,\"l2_writes\":%u,\"l2_write_misses\":%u,\"l2_miss_rate\":%.6f,\"l2_writebacks\":%u,\"l2_prefetches\":%u",
+           l2.reads, l2.read_misses, l2.writes, l2.write_misses, l2.miss_rate, l2.write_backs, l2.prefetches);
+    bool l1_classified = (cache_l1->miss_classifier != nullptr);
+    bool l2_classified = (cache_l2->miss_classifier != nullptr);
+    bool victim_exists = (cache_l1->victim_cache != nullptr);
+    print_optional_counter(out, "l1_compulsory_misses", l1.compulsory_misses, l1_classified);
+    print_optional_counter(out, "l1_capacity_misses", l1.capacity_misses, l1_classified);
+    print_optional_counter(out, "l1_conflict_misses", l1.conflict_misses, l1_classified);
+    print_optional_counter(out, "l1_swap_requests", l1.swap_requests, victim_exists);
+    print_optional_counter(out, "l1_swaps", l1.swaps, victim_exists);
+    print_optional_counter(out, "l2_compulsory_misses", l2.compulsory_misses, l2_classified);
+    print_optional_counter(out, "l2_capacity_misses", l2.capacity_misses, l2_classified);
+    print_optional_counter(out, "l2_conflict_misses", l2.conflict_misses, l2_classified);
+    fprintf(out, ",\"memory_traffic\":%u}\n", memory_traffic);
+}
+
+void Reporter::print_csv_record(const char* record, uint64_t accesses, uint32_t memory_traffic){
+    cache_measurements_t& l1 = cache_l1->cache_measurements;
+    cache_measurements_t& l2 = cache_l2->cache_measurements;
+    if (csv_header_printed == false)
+    {
+        fprintf(out, "record,accesses,blocksize,l1_size,l1_assoc,l2_size,l2_assoc,pref_n,pref_m,trace,"
+               "l1_reads,l1_read_misses,l1_writes,l1_write_misses,l1_miss_rate,l1_writebacks,l1_prefetches,"
+               "l2_reads,l2_read_misses,l2_prefetch_reads,l2_prefetch_read_misses,l2_writes,l2_write_misses,l2_miss_rate,l2_writebacks,l2_prefetches,"
+               "l1_compulsory_misses,l1_capacity_misses,l1_conflict_misses,l1_swap_requests,l1_swaps,"
+               "l2_compulsory_misses,l2_capacity_misses,l2_conflict_misses,"
+               "memory_traffic\n");
+        csv_header_printed = true;
+    }
+    fprintf(out, "%s,%" PRIu64 ",%u,%u,%u,%u,%u,%u,%u,", record, accesses,
+           params.BLOCKSIZE, params.L1_SIZE, params.L1_ASSOC, params.L2_SIZE, params.L2_ASSOC, params.PREF_N, params.PREF_M);
+    print_quoted(out, trace, true);
+    fprintf(out, ",%u,%u,%u,%u,%.6f,%u,%u", l1.reads, l1.read_misses, l1.writes, l1.write_misses, l1.miss_rate, l1.write_backs, l1.prefetches);
+    fprintf(out, ",%u,%u,0,0,%u,%u,%.6f,%u,%u", l2.reads, l2.read_misses, l2.writes, l2.write_misses, l2.miss_rate, l2.write_backs, l2.prefetches);
+    bool l1_classified = (cache_l1->miss_classifier != nullptr);
+    bool l2_classified = (cache_l2->miss_classifier != nullptr);
+    bool victim_exists = (cache_l1->victim_cache != nullptr);
+    print_optional_counter(out, NULL, l1.compulsory_misses, l1_classified);
+    print_optional_counter(out, NULL, l1.capacity_misses, l1_classified);
+    print_optional_counter(out, NULL, l1.conflict_misses, l1_classified);
+    print_optional_counter(out, NULL, l1.swap_requests, victim_exists);
+    print_optional_counter(out, NULL, l1.swaps, victim_exists);
+    print_optional_counter(out, NULL, l2.compulsory_misses, l2_classified);
+    print_optional_counter(out, NULL, l2.capacity_misses, l2_classified);
+    print_optional_counter(out, NULL, l2.conflict_misses, l2_classified);
+    fprintf(out, ",%u\n", memory_traffic);
+}
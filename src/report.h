@@ -0,0 +1,57 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "sim.h"
+#include "cache.h"
+
+//format of the configuration and measurement output
+typedef enum
+{
+    OUTPUT_TEXT,  //human readable blocks (default)
+    OUTPUT_JSON,  //one JSON object per line
+    OUTPUT_CSV    //header row followed by one row per record
+} output_format_t;
+
+//parse the value of --format=
+//returns false for unknown formats
+bool parse_output_format(const char*, output_format_t*);
+
+class Reporter {
+    private:
+        output_format_t format;
+        FILE* out;              //stream receiving the configuration and measurements
+        cache_params_t params;
+        const char* trace;      //trace file name or workload description
+        Cache* cache_l1;
+        Cache* cache_l2;
+        bool l2_exists;
+        bool stb_exists;
+        bool csv_header_printed;
+
+        //updates the miss rates of both the levels and returns the memory traffic
+        uint32_t update_measurements();
+        void print_text_measurements(const char*, uint64_t, uint32_t);
+        void print_json_record(const char*, uint64_t, uint32_t);
+        void print_csv_record(const char*, uint64_t, uint32_t);
+
+    public:
+        //parameterized constructor
+        //passing format, configuration, trace description, the cache hierarchy and the output stream
+        Reporter(output_format_t, const cache_params_t&, const char*, Cache*, Cache*, FILE* = stdout);
+
+        //print the simulator configuration (text format only, the structured
+        //formats carry the configuration in every record)
+        void print_configuration();
+
+        //print the cache and stream buffer contents to the given file
+        void print_contents(FILE*);
+
+        //print the counters after the given number of accesses
+        //"interval" records are emitted while the simulation runs, "final" at the end
+        void print_measurements(const char*, uint64_t);
+};
+
+#endif
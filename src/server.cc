@@ -0,0 +1,527 @@
+#include <ctype.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <new>
+#include "server.h"
+#include "cache.h"
+#include "report.h"
+
+//quote a string for a JSON answer
+static std::string json_quote(const std::string& value)
+{
+    std::string quoted = "\"";
+    for (char c : value)
+    {
+        if ((c == '"') || (c == '\\'))
+        {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if (c == '\n')
+            quoted += "\\n";
+        else if (c == '\t')
+            quoted += "\\t";
+        else if ((unsigned char)c < 0x20)
+        {
+            //other control characters are not allowed raw in a JSON string
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+            quoted += escaped;
+        }
+        else
+            quoted += c;
+    }
+    return quoted + "\"";
+}
+
+//parse the next "<r|w> <hex address>" request of a mapped trace
+//returns false at the end of the trace or on a malformed request
+static bool parse_request(const char*& p, const char* end, char& rw, uint32_t& addr)
+{
+    //skip the blank space and newlines between requests
+    while ((p < end) && isspace((unsigned char)*p)) p++;
+    if (p == end) return false;
+    rw = *p++;
+    while ((p < end) && ((*p == ' ') || (*p == '\t'))) p++;
+    //optional 0x prefix, like fscanf's %x
+    if ((end - p > 2) && (p[0] == '0') && ((p[1] == 'x') || (p[1] == 'X')) && isxdigit((unsigned char)p[2])) p += 2;
+
+    const char* digits = p;
+    uint32_t value = 0;
+    while ((p < end) && isxdigit((unsigned char)*p))
+    {
+        char c = *p++;
+        value = (value << 4) | (uint32_t)((c <= '9') ? (c - '0') : ((c | 0x20) - 'a' + 10));
+    }
+    addr = value;
+    return p != digits;
+}
+
+//parse a decimal command argument
+static bool parse_uint32(const std::string& value, uint32_t* result)
+{
+    //strtoul would accept blank space and a minus sign
+    if (isdigit((unsigned char)value[0]) == 0) return false;
+    char* end;
+    unsigned long number = strtoul(value.c_str(), &end, 10);
+    if ((*end != '\0') || (number > UINT32_MAX)) return false;
+    *result = (uint32_t)number;
+    return true;
+}
+
+//upper bounds of the run parameters, a query must not be able to exhaust the service
+//the memory of a run grows with the number of blocks, so the blocks are bounded rather than the bytes
+#define MAX_SERVER_BLOCKSIZE (1u << 16)
+#define MAX_SERVER_BLOCKS (1u << 24)           //blocks of L1 and L2 together
+#define MAX_SERVER_ASSOC 1024
+#define MAX_SERVER_STREAM_BUFFERS 64
+#define MAX_SERVER_STREAM_BLOCKS 1024
+#define MAX_SERVER_ACCESSES (1ull << 32)       //requests of a synthetic workload
+#define MAX_SERVER_WORKERS 256
+
+//checks one level of the hierarchy
+//the products are done in 64 bits so huge values cannot wrap around to 0
+static bool check_level(uint32_t block_size, uint32_t size, uint32_t assoc)
+{
+    if ((size == 0) || ((size / block_size) > MAX_SERVER_BLOCKS)) return false;
+    if ((assoc == 0) || (assoc > MAX_SERVER_ASSOC)) return false;
+    uint64_t set_size = (uint64_t)block_size * assoc;
+    if ((size % set_size) != 0) return false;
+    //calc_cache_properties takes the log2 of the number of sets
+    uint64_t number_of_sets = size / set_size;
+    return (number_of_sets & (number_of_sets - 1)) == 0;
+}
+
+//reject configurations the simulator cannot represent
+//returns NULL for a valid configuration
+static const char* check_params(const cache_params_t& params)
+{
+    if ((params.BLOCKSIZE == 0) || (params.BLOCKSIZE > MAX_SERVER_BLOCKSIZE) || ((params.BLOCKSIZE & (params.BLOCKSIZE - 1)) != 0))
+        return "BLOCKSIZE must be a power of two up to 65536";
+    if (check_level(params.BLOCKSIZE, params.L1_SIZE, params.L1_ASSOC) == false)
+        return "L1_SIZE must be BLOCKSIZE * L1_ASSOC times a power of two, at most 16M blocks, L1_ASSOC at most 1024";
+    if ((params.L2_SIZE != 0) && (check_level(params.BLOCKSIZE, params.L2_SIZE, params.L2_ASSOC) == false))
+        return "L2_SIZE must be BLOCKSIZE * L2_ASSOC times a power of two, at most 16M blocks, L2_ASSOC at most 1024";
+    if (((uint64_t)params.L1_SIZE + params.L2_SIZE) / params.BLOCKSIZE > MAX_SERVER_BLOCKS)
+        return "L1 and L2 must hold at most 16M blocks together";
+    if (params.PREF_N > MAX_SERVER_STREAM_BUFFERS)
+        return "PREF_N must be at most 64";
+    if ((params.PREF_N != 0) && ((params.PREF_M == 0) || (params.PREF_M > MAX_SERVER_STREAM_BLOCKS)))
+        return "PREF_M must be between 1 and 1024 when PREF_N is set";
+    return NULL;
+}
+
+SimServer::SimServer(uint32_t number_of_workers, bool cache_results_p){
+    cache_results = cache_results_p;
+    next_generation = 0;
+    stopping = false;
+    for (uint32_t i = 0; i < number_of_workers; i++)
+    {
+        workers.emplace_back(&SimServer::worker_loop, this);
+    }
+}
+
+SimServer::~SimServer(){
+    //let the workers drain the queue before exiting
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        stopping = true;
+    }
+    jobs_available.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void SimServer::respond(const std::string& answer){
+    std::lock_guard<std::mutex> lock(output_mutex);
+    fputs(answer.c_str(), stdout);
+    fputc('\n', stdout);
+    fflush(stdout);
+}
+
+void SimServer::respond_error(const char* field, const std::string& value, const std::string& message){
+    respond(std::string("{\"") + field + "\":" + json_quote(value) + ",\"status\":\"error\",\"message\":" + json_quote(message) + "}");
+}
+
+void SimServer::handle_load(const std::vector<std::string>& args){
+    if (args.size() != 3)
+    {
+        respond_error("command", "load", "usage: load <name> <trace file>");
+        return;
+    }
+
+    int fd = open(args[2].c_str(), O_RDONLY);
+    struct stat file_stat;
+    if ((fd < 0) || (fstat(fd, &file_stat) != 0))
+    {
+        if (fd >= 0) close(fd);
+        respond_error("command", "load", "Unable to open file " + args[2]);
+        return;
+    }
+    size_t size = file_stat.st_size;
+    const char* data = nullptr;
+    if (size != 0)
+    {
+        void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(fd);
+            respond_error("command", "load", "Unable to map file " + args[2]);
+            return;
+        }
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = (const char*)mapping;
+    }
+    //the mapping stays valid after closing the descriptor
+    close(fd);
+
+    //the mapping is released once the trace is unloaded and no job uses it
+    std::shared_ptr<loaded_trace_t> trace(new loaded_trace_t, [](loaded_trace_t* trace){
+        if (trace->size != 0) munmap((void*)trace->data, trace->size);
+        delete trace;
+    });
+    trace->name = args[1];
+    trace->path = args[2];
+    trace->data = data;
+    trace->size = size;
+    trace->requests = 0;
+    trace->generation = next_generation++;
+
+    //validate the trace once so the runs never see a malformed request
+    const char* p = data;
+    const char* end = data + size;
+    char rw;
+    uint32_t addr;
+    while (parse_request(p, end, rw, addr))
+    {
+        if ((rw != 'r') && (rw != 'w')) break;
+        trace->requests++;
+    }
+    while ((p < end) && isspace((unsigned char)*p)) p++;
+    if (p != end)
+    {
+        respond_error("command", "load", "Malformed request " + std::to_string(trace->requests + 1) + " in " + args[2]);
+        return;
+    }
+
+    traces[trace->name] = trace;
+    respond("{\"command\":\"load\",\"status\":\"ok\",\"trace\":" + json_quote(trace->name) + ",\"requests\":" + std::to_string(trace->requests) + "}");
+}
+
+void SimServer::handle_unload(const std::vector<std::string>& args){
+    if ((args.size() != 2) || (traces.erase(args[1]) == 0))
+    {
+        respond_error("command", "unload", "Unknown trace " + ((args.size() > 1) ? args[1] : std::string()));
+        return;
+    }
+    respond("{\"command\":\"unload\",\"status\":\"ok\",\"trace\":" + json_quote(args[1]) + "}");
+}
+
+void SimServer::handle_run(const std::vector<std::string>& args){
+    if (args.size() < 2)
+    {
+        respond_error("command", "run", "usage: run <id> <trace|gen:spec> BLOCKSIZE L1_SIZE L1_ASSOC L2_SIZE L2_ASSOC PREF_N PREF_M [options]");
+        return;
+    }
+    simulation_job_t job;
+    job.id = args[1];
+    job.options = {false, false, 0};
+    if (args.size() < 10)
+    {
+        respond_error("id", job.id, "Expected a trace and 7 cache parameters");
+        return;
+    }
+
+    uint32_t* fields[] = {&job.params.BLOCKSIZE, &job.params.L1_SIZE, &job.params.L1_ASSOC, &job.params.L2_SIZE,
+                          &job.params.L2_ASSOC, &job.params.PREF_N, &job.params.PREF_M};
+    for (uint32_t i = 0; i < 7; i++)
+    {
+        if (parse_uint32(args[3 + i], fields[i]) == false)
+        {
+            respond_error("id", job.id, "Invalid cache parameter " + args[3 + i]);
+            return;
+        }
+    }
+    const char* error = check_params(job.params);
+    if (error != NULL)
+    {
+        respond_error("id", job.id, error);
+        return;
+    }
+    for (size_t i = 10; i < args.size(); i++)
+    {
+        if (parse_cache_option(args[i].c_str(), &job.options) == false)
+        {
+            respond_error("id", job.id, "Unknown or invalid option " + args[i]);
+            return;
+        }
+    }
+
+    //requests come from a loaded trace or a synthetic workload
+    //the key is built from the parsed values so the spelling and order of the arguments
+    //do not matter, --compact is left out because it does not change the results
+    char key[512];
+    const std::string& source = args[2];
+    if (source.compare(0, 4, "gen:") == 0)
+    {
+        if (parse_workload_spec(source.c_str(), job.params.BLOCKSIZE, &job.workload) == false)
+        {
+            respond_error("id", job.id, "Invalid workload spec " + source);
+            return;
+        }
+        if (job.workload.accesses > MAX_SERVER_ACCESSES)
+        {
+            respond_error("id", job.id, "A workload may issue at most 4G requests");
+            return;
+        }
+        const workload_params_t& workload = job.workload;
+        snprintf(key, sizeof(key), "gen:%u,%" PRIu64 ",%" PRIu64 ",%u,%.17g,%" PRIu64 ",%.17g,%" PRIu64 ",%u",
+                 (uint32_t)workload.pattern, workload.accesses, workload.footprint, workload.stride,
+                 workload.write_ratio, workload.seed, workload.theta, workload.phase_length, workload.base_addr);
+        job.key = key;
+    }
+    else
+    {
+        auto trace = traces.find(source);
+        if (trace == traces.end())
+        {
+            respond_error("id", job.id, "Unknown trace " + source);
+            return;
+        }
+        job.trace = trace->second;
+        //a reloaded trace must not reuse the results of the old one
+        job.key = "trace:" + std::to_string(job.trace->generation);
+    }
+    snprintf(key, sizeof(key), " %u %u %u %u %u %u %u classify=%d victim=%u",
+             job.params.BLOCKSIZE, job.params.L1_SIZE, job.params.L1_ASSOC, job.params.L2_SIZE,
+             job.params.L2_ASSOC, job.params.PREF_N, job.params.PREF_M,
+             (int)job.options.classify_misses, job.options.victim_blocks);
+    job.key += key;
+
+    if (cache_results == true)
+    {
+        std::string result;
+        bool found;
+        {
+            std::lock_guard<std::mutex> lock(results_mutex);
+            found = find_result(job.key, result);
+            if (found == false)
+            {
+                //an identical run is queued or running -> answer with its result
+                auto waiting = pending.find(job.key);
+                if (waiting != pending.end())
+                {
+                    waiting->second.push_back(job.id);
+                    return;
+                }
+                //no one waits for this run yet
+                pending[job.key] = std::vector<std::string>();
+            }
+        }
+        if (found == true)
+        {
+            respond("{\"id\":" + json_quote(job.id) + ",\"status\":\"ok\",\"cached\":true,\"result\":" + result + "}");
+            return;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        jobs.push_back(job);
+    }
+    jobs_available.notify_one();
+}
+
+//looks up a previous answer and marks it most recently used
+//called with results_mutex held
+bool SimServer::find_result(const std::string& key, std::string& result){
+    auto entry = result_index.find(key);
+    if (entry == result_index.end()) return false;
+    results.splice(results.begin(), results, entry->second);
+    result = entry->second->second;
+    return true;
+}
+
+//keeps an answer, dropping the least recently used one when the cache is full
+//called with results_mutex held
+void SimServer::store_result(const std::string& key, const std::string& result){
+    if (result_index.count(key) != 0) return;
+    if (results.size() == MAX_CACHED_RESULTS)
+    {
+        result_index.erase(results.back().first);
+        results.pop_back();
+    }
+    results.emplace_front(key, result);
+    result_index[key] = results.begin();
+}
+
+void SimServer::worker_loop(){
+    while (true)
+    {
+        simulation_job_t job;
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            jobs_available.wait(lock, [this]{ return (stopping == true) || (jobs.empty() == false); });
+            if (jobs.empty() == true) return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        std::string result;
+        std::string error;
+        bool ok = simulate(job, result, error);
+
+        //runs merged into this one get the same answer
+        std::vector<std::string> waiting;
+        if (cache_results == true)
+        {
+            std::lock_guard<std::mutex> lock(results_mutex);
+            auto entry = pending.find(job.key);
+            if (entry != pending.end())
+            {
+                waiting.swap(entry->second);
+                pending.erase(entry);
+            }
+            if (ok == true) store_result(job.key, result);
+        }
+        if (ok == false)
+        {
+            respond_error("id", job.id, error);
+            for (const std::string& id : waiting) respond_error("id", id, error);
+            continue;
+        }
+        respond("{\"id\":" + json_quote(job.id) + ",\"status\":\"ok\",\"cached\":false,\"result\":" + result + "}");
+        for (const std::string& id : waiting)
+        {
+            respond("{\"id\":" + json_quote(id) + ",\"status\":\"ok\",\"cached\":true,\"result\":" + result + "}");
+        }
+    }
+}
+
+bool SimServer::simulate(const simulation_job_t& job, std::string& result, std::string& error){
+    Cache* cache_l1 = nullptr;
+    Cache* cache_l2 = nullptr;
+    Workload* workload = nullptr;
+    uint64_t accesses = 0;
+    char rw;
+    uint32_t addr;
+    bool ok = true;
+    //a failed allocation only fails this run, the other workers keep going
+    try
+    {
+        generate_hierarchy(job.params, job.options, &cache_l1, &cache_l2);
+        if (job.trace != nullptr)
+        {
+            //the trace was validated when it was loaded
+            const char* p = job.trace->data;
+            const char* end = p + job.trace->size;
+            while (parse_request(p, end, rw, addr))
+            {
+                cache_l1->request(addr, rw);
+                accesses++;
+            }
+        }
+        else
+        {
+            workload = new Workload(job.workload);
+            while (workload->next(addr, rw))
+            {
+                cache_l1->request(addr, rw);
+                accesses++;
+            }
+        }
+    }
+    catch (std::bad_alloc&)
+    {
+        error = "Unable to allocate the caches";
+        ok = false;
+    }
+
+    //format the measurements exactly like --format=json
+    if (ok == true)
+    {
+        char* buffer = NULL;
+        size_t length = 0;
+        FILE* out = open_memstream(&buffer, &length);
+        ok = (out != NULL);
+        if (ok == true)
+        {
+            const char* trace = (workload != nullptr) ? workload->get_description() : job.trace->name.c_str();
+            Reporter reporter(OUTPUT_JSON, job.params, trace, cache_l1, cache_l2, out);
+            reporter.print_measurements("final", accesses);
+            fclose(out);
+            //drop the newline ending the record
+            result.assign(buffer, (length > 0) ? length - 1 : 0);
+            free(buffer);
+        }
+        else
+        {
+            error = "Unable to allocate the result";
+        }
+    }
+
+    delete workload;
+    delete cache_l1;
+    delete cache_l2;
+    return ok;
+}
+
+void SimServer::serve(FILE* in){
+    char* line = NULL;
+    size_t capacity = 0;
+    while (getline(&line, &capacity, in) != -1)
+    {
+        //split the command on blank space
+        std::vector<std::string> args;
+        char* save;
+        for (char* token = strtok_r(line, " \t\r\n", &save); token != NULL; token = strtok_r(NULL, " \t\r\n", &save))
+        {
+            args.push_back(token);
+        }
+        if (args.empty() == true) continue;
+
+        if (args[0] == "load")
+            handle_load(args);
+        else if (args[0] == "unload")
+            handle_unload(args);
+        else if (args[0] == "run")
+            handle_run(args);
+        else if (args[0] == "quit")
+            break;
+        else
+            respond_error("command", args[0], "Unknown command");
+    }
+    free(line);
+}
+
+int run_server(int argc, char* argv[]){
+    uint32_t number_of_workers = std::thread::hardware_concurrency();
+    bool cache_results = false;
+    for (int i = 2; i < argc; i++)
+    {
+        bool ok = true;
+        if (strncmp(argv[i], "--workers=", 10) == 0)
+        {
+            ok = parse_uint32(argv[i] + 10, &number_of_workers) && (number_of_workers != 0) && (number_of_workers <= MAX_SERVER_WORKERS);
+        }
+        else if (strcmp(argv[i], "--cache-results") == 0)
+            cache_results = true;
+        else
+            ok = false;
+        if (ok == false) {
+            printf("Error: Unknown or invalid option %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    //hardware_concurrency returns 0 when it is not computable
+    if (number_of_workers == 0) number_of_workers = 1;
+
+    SimServer server(number_of_workers, cache_results);
+    server.serve(stdin);
+    return(0);
+}
@@ -0,0 +1,115 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "sim.h"
+#include "workload.h"
+
+/*  Simulation service: ./sim --serve [--workers=N] [--cache-results]
+
+    Reads one command per line from stdin and writes one JSON object per line to stdout.
+    Traces are memory-mapped once and simulated straight from the mapping by a pool of
+    worker threads, so a query only costs the simulation itself.
+
+    load <name> <trace file>
+        -> {"command":"load","status":"ok","trace":"<name>","requests":N}
+    unload <name>
+        -> {"command":"unload","status":"ok","trace":"<name>"}
+    run <id> <name|gen:spec> BLOCKSIZE L1_SIZE L1_ASSOC L2_SIZE L2_ASSOC PREF_N PREF_M [--compact] [--classify] [--victim=N]
+        -> {"id":"<id>","status":"ok","cached":false,"result":{...same fields as --format=json...}}
+    quit
+        finish the queued runs and exit (same as end of input)
+
+    Failures answer {"command":...,"status":"error","message":"..."} or {"id":...,"status":"error",...}.
+    Runs finish out of order, use the id to match the answers.
+    With --cache-results identical runs are simulated once: repeats and runs submitted while an
+    identical one is in flight answer "cached":true.
+*/
+
+//trace file mapped into memory
+typedef struct
+{
+    std::string name;
+    std::string path;
+    const char* data;   //start of the mapping
+    size_t size;        //size of the mapping in bytes
+    uint64_t requests;  //number of requests in the trace
+    uint64_t generation;//distinguishes reloads of the same name in the result cache
+} loaded_trace_t;
+
+//a queued "run" command
+typedef struct
+{
+    std::string id;
+    std::string key;                        //result cache key, built from the parsed arguments
+    std::shared_ptr<loaded_trace_t> trace;  //nullptr -> synthetic workload
+    workload_params_t workload;
+    cache_params_t params;
+    cache_options_t options;
+} simulation_job_t;
+
+//number of answers kept by --cache-results
+#define MAX_CACHED_RESULTS 4096
+
+class SimServer {
+    private:
+        bool cache_results;
+        uint64_t next_generation;
+
+        //traces by name, shared with the jobs that still use them
+        std::map<std::string, std::shared_ptr<loaded_trace_t>> traces;
+
+        //job queue of the worker pool
+        std::vector<std::thread> workers;
+        std::deque<simulation_job_t> jobs;
+        std::mutex jobs_mutex;
+        std::condition_variable jobs_available;
+        bool stopping;
+
+        //answers of previous runs by cache key, most recently used first
+        //bounded to MAX_CACHED_RESULTS entries
+        std::list<std::pair<std::string, std::string>> results;
+        std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator> result_index;
+        //ids of the runs waiting for an identical run that is queued or running
+        std::unordered_map<std::string, std::vector<std::string>> pending;
+        std::mutex results_mutex;
+
+        //serializes the answers on stdout
+        std::mutex output_mutex;
+
+        void respond(const std::string&);
+        void respond_error(const char*, const std::string&, const std::string&);
+
+        void handle_load(const std::vector<std::string>&);
+        void handle_unload(const std::vector<std::string>&);
+        void handle_run(const std::vector<std::string>&);
+
+        bool find_result(const std::string&, std::string&);
+        void store_result(const std::string&, const std::string&);
+
+        void worker_loop();
+        bool simulate(const simulation_job_t&, std::string&, std::string&);
+
+    public:
+        //parameterized constructor
+        //passing the number of worker threads and whether results are cached
+        SimServer(uint32_t, bool);
+        ~SimServer();
+
+        //process commands until quit or end of input
+        void serve(FILE*);
+};
+
+#endif
@@ -1,67 +1,78 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <new>
 #include "sim.h"
 #include "cache.h"
+#include "workload.h"
+#include "report.h"
 
 /*  "argc" holds the number of command-line arguments.
     "argv[]" holds the arguments themselves.
 
     Example:
     ./sim 32 8192 4 262144 8 3 10 gcc_trace.txt
+    ./sim 32 8192 4 262144 8 3 10 gen:zipf,n=50M,fp=64M,wr=0.2,seed=7
+    ./sim 32 8192 4 262144 8 3 10 gcc_trace.txt --compact
+    ./sim 32 8192 4 262144 8 3 10 gcc_trace.txt --format=json --interval=1000000 --dump=contents.txt
+    ./sim 32 8192 1 262144 8 0 0 gcc_trace.txt --classify --victim=8
+    ./sim --serve --workers=4 --cache-results   (see server.h for the protocol)
     argc = 9
     argv[0] = "./sim"
     argv[1] = "32"
     argv[2] = "8192"
     ... and so on
+    Options may follow the trace file:
+    --compact          bit-packed, lazily allocated cache state for very large caches
+    --format=FORMAT    text (default), json (one object per line) or csv
+    --interval=N       also print the counters every N accesses
+    --dump=FILE        write the cache contents to FILE instead of stdout
+    --no-dump          do not print the cache contents
+                       (json and csv only print the contents with --dump)
+    --classify         split the misses of every level into compulsory/capacity/conflict
+    --victim=N         add an N block (1..1024) fully associative victim cache below L1
 */
-int main (int argc, char *argv[]) {
-    FILE *fp;			// File pointer.
-    char *trace_file;		// This variable holds the trace file name.
-    cache_params_t params;	// Look at the sim.h header file for the definition of struct cache_params_t.
-    char rw;			// This variable holds the request's type (read or write) obtained from the trace.
-    uint32_t addr;		// This variable holds the request's address obtained from the trace.
-                // The header file <inttypes.h> above defines signed and unsigned integers of various sizes in a machine-agnostic way.  "uint32_t" is an unsigned integer of 32 bits.
-
-    // Exit with an error if the number of command-line arguments is incorrect.
-    if (argc != 9) {
-        printf("Error: Expected 8 command-line arguments but was provided %d.\n", (argc - 1));
-        exit(EXIT_FAILURE);
+bool parse_cache_option(const char* arg, cache_options_t* options) {
+    if (strcmp(arg, "--compact") == 0)
+        options->compact_state = true;
+    else if (strcmp(arg, "--classify") == 0)
+        options->classify_misses = true;
+    else if (strncmp(arg, "--victim=", 9) == 0) {
+        // The victim cache is small and fully associative: 1..MAX_VICTIM_BLOCKS blocks.
+        char* end;
+        unsigned long blocks = strtoul(arg + 9, &end, 10);
+        if ((arg[9] < '0') || (arg[9] > '9') || (*end != '\0') || (blocks == 0) || (blocks > MAX_VICTIM_BLOCKS))
+            return false;
+        options->victim_blocks = (uint32_t) blocks;
     }
-    
-    // "atoi()" (included by <stdlib.h>) converts a string (char *) to an integer (int).
-    params.BLOCKSIZE = (uint32_t) atoi(argv[1]);
-    params.L1_SIZE   = (uint32_t) atoi(argv[2]);
-    params.L1_ASSOC  = (uint32_t) atoi(argv[3]);
-    params.L2_SIZE   = (uint32_t) atoi(argv[4]);
-    params.L2_ASSOC  = (uint32_t) atoi(argv[5]);
-    params.PREF_N    = (uint32_t) atoi(argv[6]);
-    params.PREF_M    = (uint32_t) atoi(argv[7]);
-    trace_file       = argv[8];
+    else
+        return false;
+    return true;
+}
 
-    // Open the trace file for reading.
-    fp = fopen(trace_file, "r");
-    if (fp == (FILE *) NULL) {
-        // Exit with an error if file open failed.
-        printf("Error: Unable to open file %s\n", trace_file);
-        exit(EXIT_FAILURE);
-    }
-    
-    // Print simulator configuration.
-    printf("===== Simulator configuration =====\n");
-    printf("BLOCKSIZE:  %u\n", params.BLOCKSIZE);
-    printf("L1_SIZE:    %u\n", params.L1_SIZE);
-    printf("L1_ASSOC:   %u\n", params.L1_ASSOC);
-    printf("L2_SIZE:    %u\n", params.L2_SIZE);
-    printf("L2_ASSOC:   %u\n", params.L2_ASSOC);
-    printf("PREF_N:     %u\n", params.PREF_N);
-    printf("PREF_M:     %u\n", params.PREF_M);
-    printf("trace_file: %s\n", trace_file);
-    printf("\n");
-    
+void generate_hierarchy(const cache_params_t& params, const cache_options_t& options, Cache** l1, Cache** l2) {
     //create caches for L1 and L2
-    Cache* cache_l1 = new Cache(params.BLOCKSIZE, params.L1_SIZE, params.L1_ASSOC);
-    Cache* cache_l2 = new Cache(params.BLOCKSIZE, params.L2_SIZE, params.L2_ASSOC);
+    //they are handed out right away so the caller can free them if a later allocation throws
+    *l1 = nullptr;
+    *l2 = nullptr;
+    Cache* cache_l1 = *l1 = new Cache(params.BLOCKSIZE, params.L1_SIZE, params.L1_ASSOC, options.compact_state);
+    Cache* cache_l2 = *l2 = new Cache(params.BLOCKSIZE, params.L2_SIZE, params.L2_ASSOC, options.compact_state);
+
+    //attach the optional victim cache and miss classifiers
+    if (options.victim_blocks != 0)
+    {
+        cache_l1->generate_victim_cache(options.victim_blocks);
+    }
+    if (options.classify_misses == true)
+    {
+        cache_l1->generate_miss_classifier();
+        if (params.L2_SIZE != 0)
+        {
+            cache_l2->generate_miss_classifier();
+        }
+    }
 
     //based on the L2 size paramenter, decide whether L2 is present
     bool l2_exists = false;
@@ -95,79 +106,163 @@ int main (int argc, char *argv[]) {
             cache_l1->generate_stream_buffer(params.PREF_N,params.PREF_M);
             }
     }
+}
 
-    // Read requests from the trace file and echo them back.
-    while (fscanf(fp, "%c %x\n", &rw, &addr) == 2) {	// Stay in the loop if fscanf() successfully parsed two tokens as specified.
-        if (rw == 'r')
-            // printf("r %x\n", addr);
-            cache_l1->request(addr,'r');
-        else if (rw == 'w')
-            // printf("w %x\n", addr);
-            cache_l1->request(addr,'w');
-        else {
-            printf("Error: Unknown request type %c.\n", rw);
-        exit(EXIT_FAILURE);
-        }
+int main (int argc, char *argv[]) {
+    FILE *fp = NULL;		// File pointer.
+    char *trace_file;		// This variable holds the trace file name.
+    cache_params_t params;	// Look at the sim.h header file for the definition of struct cache_params_t.
+    char rw;			// This variable holds the request's type (read or write) obtained from the trace.
+    uint32_t addr;		// This variable holds the request's address obtained from the trace.
+    workload_params_t workload_params;	// Synthetic workload used instead of a trace file ("gen:..." argument).
+    Workload* workload = nullptr;
+    cache_options_t options = {false, false, 0};	// Cache options, see sim.h.
+    output_format_t format = OUTPUT_TEXT;	// Format of the configuration and measurements.
+    uint64_t interval = 0;	// Print the counters every "interval" accesses, 0 -> only at the end.
+    const char* dump_file = NULL;	// File receiving the cache contents, NULL -> stdout.
+    FILE* dump_fp = stdout;	// Stream of the cache contents.
+    bool dump_contents = true;	// Print the cache contents at the end.
+                // The header file <inttypes.h> above defines signed and unsigned integers of various sizes in a machine-agnostic way.  "uint32_t" is an unsigned integer of 32 bits.
+
+    // Serve simulation requests instead of running a single simulation.
+    if ((argc >= 2) && (strcmp(argv[1], "--serve") == 0))
+        return run_server(argc, argv);
 
-      ///////////////////////////////////////////////////////
-      // Issue the request to the L1 cache instance here.
-      ///////////////////////////////////////////////////////
+    // Exit with an error if the number of command-line arguments is incorrect.
+    if (argc < 9) {
+        printf("Error: Expected at least 8 command-line arguments but was provided %d.\n", (argc - 1));
+        exit(EXIT_FAILURE);
     }
+    
+    // "atoi()" (included by <stdlib.h>) converts a string (char *) to an integer (int).
+    params.BLOCKSIZE = (uint32_t) atoi(argv[1]);
+    params.L1_SIZE   = (uint32_t) atoi(argv[2]);
+    params.L1_ASSOC  = (uint32_t) atoi(argv[3]);
+    params.L2_SIZE   = (uint32_t) atoi(argv[4]);
+    params.L2_ASSOC  = (uint32_t) atoi(argv[5]);
+    params.PREF_N    = (uint32_t) atoi(argv[6]);
+    params.PREF_M    = (uint32_t) atoi(argv[7]);
+    trace_file       = argv[8];
 
-    printf("===== L1 contents =====\n");
-    cache_l1->print_cache_contents();
-    uint32_t memory_traffic = 0;
+    // Parse the options following the trace file.
+    for (int i = 9; i < argc; i++) {
+        if (parse_cache_option(argv[i], &options) == true)
+            continue;
+        else if (strncmp(argv[i], "--format=", 9) == 0) {
+            if (parse_output_format(argv[i] + 9, &format) == false) {
+                printf("Error: Unknown output format %s\n", argv[i] + 9);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strncmp(argv[i], "--interval=", 11) == 0) {
+            // A decimal number of accesses, 0 keeps only the final record.
+            char* end;
+            errno = 0;
+            interval = strtoull(argv[i] + 11, &end, 10);
+            if ((argv[i][11] < '0') || (argv[i][11] > '9') || (*end != '\0') || (errno == ERANGE)) {
+                printf("Error: Unknown or invalid option %s\n", argv[i]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strncmp(argv[i], "--dump=", 7) == 0) {
+            dump_file = argv[i] + 7;
+            dump_contents = true;
+        }
+        else if (strcmp(argv[i], "--no-dump") == 0) {
+            dump_contents = false;
+        }
+        else {
+            printf("Error: Unknown or invalid option %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    // The structured formats keep stdout machine readable.
+    if ((format != OUTPUT_TEXT) && (dump_file == NULL))
+        dump_contents = false;
+    // Open the dump file before simulating so a bad path does not lose the results of a long run.
+    if ((dump_contents == true) && (dump_file != NULL)) {
+        if ((dump_fp = fopen(dump_file, "w")) == (FILE *) NULL) {
+            printf("Error: Unable to open file %s\n", dump_file);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    if (l2_exists == false)
-    {
-        memory_traffic = cache_l1->cache_measurements.write_backs + cache_l1->cache_measurements.read_misses + cache_l1->cache_measurements.write_misses + cache_l1->cache_measurements.prefetches;
+    // A "gen:" argument streams a synthetic workload instead of reading a trace file.
+    if (strncmp(trace_file, "gen:", 4) == 0) {
+        if (parse_workload_spec(trace_file, params.BLOCKSIZE, &workload_params) == false) {
+            printf("Error: Invalid workload spec %s\n", trace_file);
+            exit(EXIT_FAILURE);
+        }
+        workload = new Workload(workload_params);
     }
-    else 
-    {
-        printf("\n");
-        printf("===== L2 contents =====\n");
-        memory_traffic = cache_l2->cache_measurements.write_backs + cache_l2->cache_measurements.read_misses + cache_l2->cache_measurements.write_misses + cache_l2->cache_measurements.prefetches;
-        cache_l2->print_cache_contents();
-        cache_l2->cache_measurements.miss_rate = (float)(cache_l2->cache_measurements.read_misses)/(float)(cache_l2->cache_measurements.reads);
+    // Open the trace file for reading.
+    else if ((fp = fopen(trace_file, "r")) == (FILE *) NULL) {
+        // Exit with an error if file open failed.
+        printf("Error: Unable to open file %s\n", trace_file);
+        exit(EXIT_FAILURE);
+    }
+    
+    //create caches for L1 and L2
+    Cache* cache_l1;
+    Cache* cache_l2;
+    try {
+        generate_hierarchy(params, options, &cache_l1, &cache_l2);
+    }
+    catch (std::bad_alloc&) {
+        printf("Error: Unable to allocate the caches\n");
+        exit(EXIT_FAILURE);
     }
 
-    //caclulate miss rates
-    cache_l1->cache_measurements.miss_rate = (float)(cache_l1->cache_measurements.read_misses + cache_l1->cache_measurements.write_misses)/(float)(cache_l1->cache_measurements.reads + cache_l1->cache_measurements.writes);
+    // Print simulator configuration.
+    Reporter* reporter = new Reporter(format, params, (workload != nullptr) ? workload->get_description() : trace_file, cache_l1, cache_l2);
+    reporter->print_configuration();
 
-    //check for stream buffer output
-    if (stb_exists == true)
-    {
-        printf("\n");
-        printf("===== Stream Buffer(s) contents =====\n");
-        //check the hierarchy for which the stream buffer is added
-        if (l2_exists == true)
-        {
-            cache_l2->print_stream_buffer_contents();
+    // Number of requests issued so far and at which count the next interval record is due.
+    uint64_t accesses = 0;
+    uint64_t next_interval = (interval != 0) ? interval : UINT64_MAX;
+
+    // Stream the synthetic requests straight into L1.
+    if (workload != nullptr) {
+        while (workload->next(addr, rw)) {
+            cache_l1->request(addr, rw);
+            if (++accesses == next_interval) {
+                reporter->print_measurements("interval", accesses);
+                next_interval += interval;
+            }
         }
-        else 
-        {
-            cache_l1->print_stream_buffer_contents();
+    }
+    else {
+        // Read requests from the trace file and echo them back.
+        while (fscanf(fp, "%c %x\n", &rw, &addr) == 2) {	// Stay in the loop if fscanf() successfully parsed two tokens as specified.
+            if (rw == 'r')
+                // printf("r %x\n", addr);
+                cache_l1->request(addr,'r');
+            else if (rw == 'w')
+                // printf("w %x\n", addr);
+                cache_l1->request(addr,'w');
+            else {
+                printf("Error: Unknown request type %c.\n", rw);
+            exit(EXIT_FAILURE);
+            }
+
+          ///////////////////////////////////////////////////////
+          // Issue the request to the L1 cache instance here.
+          ///////////////////////////////////////////////////////
+            if (++accesses == next_interval) {
+                reporter->print_measurements("interval", accesses);
+                next_interval += interval;
+            }
         }
     }
-    printf("\n");
-    printf("===== Measurements =====\n");
-    printf("a. L1 reads:                   %u\n",cache_l1->cache_measurements.reads);
-    printf("b. L1 read misses:             %u\n",cache_l1->cache_measurements.read_misses);
-    printf("c. L1 writes:                  %u\n",cache_l1->cache_measurements.writes);
-    printf("d. L1 write misses:            %u\n",cache_l1->cache_measurements.write_misses);
-    printf("e. L1 miss rate:               %.4f\n",cache_l1->cache_measurements.miss_rate);
-    printf("f. L1 writebacks:              %u\n",cache_l1->cache_measurements.write_backs);
-    printf("g. L1 prefetches:              %u\n",cache_l1->cache_measurements.prefetches);
-    printf("h. L2 reads (demand):          %u\n",cache_l2->cache_measurements.reads);
-    printf("i. L2 read misses (demand):    %u\n",cache_l2->cache_measurements.read_misses);
-    printf("j. L2 reads (prefetch):        0\n");
-    printf("k. L2 read misses (prefetch):  0\n");
-    printf("l. L2 writes:                  %u\n",cache_l2->cache_measurements.writes);
-    printf("m. L2 write misses:            %u\n",cache_l2->cache_measurements.write_misses);
-    printf("n. L2 miss rate:               %.4f\n",cache_l2->cache_measurements.miss_rate);
-    printf("o. L2 writebacks:              %u\n",cache_l2->cache_measurements.write_backs);
-    printf("p. L2 prefetches:              %u\n",cache_l2->cache_measurements.prefetches);
-    printf("q. memory traffic:             %u\n",memory_traffic);
+
+    // Print the cache contents either inline or to the separate dump file.
+    if (dump_contents == true) {
+        reporter->print_contents(dump_fp);
+        if (dump_fp != stdout)
+            fclose(dump_fp);
+    }
+
+    reporter->print_measurements("final", accesses);
 
     return(0);
 }
@@ -15,6 +15,29 @@ struct {
 
 // Put additional data structures here as per your requirement.
 
+class Cache;
+
+// cache options passed after the trace file, shared by the command line and the server
+typedef
+struct {
+   bool compact_state;     //bit-packed, lazily allocated cache state
+   bool classify_misses;   //3C miss classification on every level
+   uint32_t victim_blocks; //blocks in the L1 victim cache, 0-> no victim cache
+} cache_options_t;
+
+// largest victim cache accepted by --victim=N
+#define MAX_VICTIM_BLOCKS 1024
+
+// parse a single cache option (--compact, --classify, --victim=N)
+// returns false if the argument is not a valid cache option
+bool parse_cache_option(const char*, cache_options_t*);
+
+// create L1 and L2 and attach the stream buffer, victim cache and miss classifiers
+// throws std::bad_alloc, the caches created so far are left in the outputs (nullptr otherwise)
+void generate_hierarchy(const cache_params_t&, const cache_options_t&, Cache**, Cache**);
+
+// run the simulation service on stdin/stdout (sim --serve ...)
+int run_server(int, char*[]);
 
 
 #endif
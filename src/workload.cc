@@ -0,0 +1,250 @@
+#include <string.h>
+#include <errno.h>
+#include "workload.h"
+#include "math.h"
+
+//number of zipf ranks whose weights are summed exactly
+//the remaining tail is approximated by the integral of x^-theta
+#define ZIPF_EXACT_TERMS (1u << 20)
+
+//the phases visited by the mixed pattern, in order
+static const workload_pattern_t mixed_phases[] = {
+    PATTERN_SEQUENTIAL, PATTERN_STRIDED, PATTERN_RANDOM, PATTERN_ZIPF, PATTERN_CHASE
+};
+static const uint32_t number_of_mixed_phases = sizeof(mixed_phases)/sizeof(mixed_phases[0]);
+
+static const char* pattern_names[] = {"seq", "stride", "random", "zipf", "chase", "mixed"};
+
+//parse an unsigned value with an optional K/M/G (power of 2) suffix
+static bool parse_size(const char* value, uint64_t* result)
+{
+    //strtoull would accept blank space and a minus sign
+    if ((*value < '0') || (*value > '9')) return false;
+    char* end;
+    errno = 0;
+    uint64_t number = strtoull(value, &end, 0);
+    if (errno == ERANGE) return false;
+    uint32_t shift = 0;
+    switch (*end)
+    {
+        case 'k': case 'K': shift = 10; end++; break;
+        case 'm': case 'M': shift = 20; end++; break;
+        case 'g': case 'G': shift = 30; end++; break;
+        default: break;
+    }
+    //the suffix must not shift bits out of the value
+    if ((*end != '\0') || (number > (UINT64_MAX >> shift))) return false;
+    number <<= shift;
+    *result = number;
+    return true;
+}
+
+static bool parse_double(const char* value, double* result)
+{
+    char* end;
+    *result = strtod(value, &end);
+    return (end != value) && (*end == '\0');
+}
+
+bool parse_workload_spec(const char* spec, uint32_t block_size, workload_params_t* params)
+{
+    //only "gen:..." arguments describe a workload, everything else is a trace file
+    if (strncmp(spec, "gen:", 4) != 0) return false;
+
+    //defaults
+    params->pattern = PATTERN_MIXED;
+    params->accesses = 10000000;
+    params->footprint = 1 << 20;
+    params->stride = 4 * block_size;
+    params->write_ratio = 0.3;
+    params->seed = 1;
+    params->theta = 0.99;
+    params->phase_length = 100000;
+    params->base_addr = 0;
+    params->block_size = block_size;
+
+    //work on a copy because strtok_r modifies the string
+    char buffer[256];
+    if (strlen(spec + 4) >= sizeof(buffer)) return false;
+    strcpy(buffer, spec + 4);
+
+    bool pattern_found = false;
+    char* save;
+    for (char* token = strtok_r(buffer, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save))
+    {
+        char* value = strchr(token, '=');
+        //the first token without a value is the pattern name
+        if (value == NULL)
+        {
+            if (pattern_found == true) return false;
+            uint32_t pattern;
+            for (pattern = 0; pattern <= PATTERN_MIXED; pattern++)
+            {
+                if (strcmp(token, pattern_names[pattern]) == 0) break;
+            }
+            if (pattern > PATTERN_MIXED) return false;
+            params->pattern = (workload_pattern_t)pattern;
+            pattern_found = true;
+            continue;
+        }
+        *value++ = '\0';
+
+        uint64_t number = 0;
+        bool ok = true;
+        if (strcmp(token, "n") == 0)
+            ok = parse_size(value, &params->accesses);
+        else if (strcmp(token, "fp") == 0)
+            ok = parse_size(value, &params->footprint);
+        else if (strcmp(token, "stride") == 0)
+        {
+            ok = parse_size(value, &number) && (number <= UINT32_MAX);
+            params->stride = (uint32_t)number;
+        }
+        else if (strcmp(token, "wr") == 0)
+            ok = parse_double(value, &params->write_ratio);
+        else if (strcmp(token, "seed") == 0)
+            ok = parse_size(value, &params->seed);
+        else if (strcmp(token, "theta") == 0)
+            ok = parse_double(value, &params->theta);
+        else if (strcmp(token, "phase") == 0)
+            ok = parse_size(value, &params->phase_length);
+        else if (strcmp(token, "base") == 0)
+        {
+            ok = parse_size(value, &number) && (number <= UINT32_MAX);
+            params->base_addr = (uint32_t)number;
+        }
+        else
+            ok = false;
+        if (ok == false) return false;
+    }
+
+    //sanity checks on the values
+    if ((block_size == 0) || ((block_size & (block_size - 1)) != 0)) return false;
+    if ((params->footprint == 0) || (params->footprint > (1ull << 32))) return false;
+    if (params->stride == 0) return false;
+    if ((params->write_ratio < 0) || (params->write_ratio > 1)) return false;
+    if ((params->theta <= 0) || (params->theta >= 1)) return false;
+    if (params->phase_length == 0) return false;
+    return true;
+}
+
+Workload::Workload(const workload_params_t& params_p){
+    params = params_p;
+    generated = 0;
+    rng_state = params.seed;
+    byte_offset = 0;
+    chase_block = 0;
+
+    //round the footprint up to a power of two number of blocks
+    block_offset_bits = log2(params.block_size);
+    uint64_t blocks = (params.footprint + params.block_size - 1) >> block_offset_bits;
+    footprint_bits = 0;
+    while ((1ull << footprint_bits) < blocks) footprint_bits++;
+    footprint_mask = (1ull << footprint_bits) - 1;
+
+    //write_ratio = 1 must turn every request into a write
+    double threshold = params.write_ratio * 4294967296.0;
+    write_threshold = (threshold >= 4294967295.0) ? UINT32_MAX : (uint32_t)threshold;
+
+    //zipf constants over all the blocks of the footprint
+    uint64_t n = footprint_mask + 1;
+    uint64_t exact_terms = (n < ZIPF_EXACT_TERMS) ? n : ZIPF_EXACT_TERMS;
+    zipf_zeta2 = 1.0 + pow(0.5, params.theta);
+    zipf_zetan = 0;
+    for (uint64_t i = 1; i <= exact_terms; i++)
+    {
+        zipf_zetan += pow((double)i, -params.theta);
+    }
+    if (n > exact_terms)
+    {
+        double one_minus_theta = 1.0 - params.theta;
+        zipf_zetan += (pow(n + 0.5, one_minus_theta) - pow(exact_terms + 0.5, one_minus_theta)) / one_minus_theta;
+    }
+    zipf_alpha = 1.0 / (1.0 - params.theta);
+    zipf_eta = (1.0 - pow(2.0 / n, 1.0 - params.theta)) / (1.0 - zipf_zeta2 / zipf_zetan);
+}
+
+//splitmix64: fast, seedable and passes BigCrush
+uint64_t Workload::next_random(){
+    uint64_t z = (rng_state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+//bijection on the footprint block numbers
+//spreads consecutive ranks/nodes over all the sets of the cache
+uint64_t Workload::scatter(uint64_t block){
+    block = (block * 0x9E3779B97F4A7C15ull) & footprint_mask;
+    block ^= block >> ((footprint_bits + 1) / 2);
+    block = (block * 0xBF58476D1CE4E5B9ull) & footprint_mask;
+    return block;
+}
+
+//draw a rank from the zipf distribution, 0 being the most popular
+//the pow() per draw dominates the cost: zipf generates ~20M requests/s against 80-100M/s for the other patterns
+uint64_t Workload::zipf_rank(uint64_t random){
+    uint64_t n = footprint_mask + 1;
+    //53 random bits -> uniform double in [0,1)
+    double u = (double)(random >> 11) * (1.0 / 9007199254740992.0);
+    double uz = u * zipf_zetan;
+    if (uz < 1.0) return 0;
+    if (uz < zipf_zeta2) return 1;
+    uint64_t rank = (uint64_t)(n * pow(zipf_eta * u - zipf_eta + 1.0, zipf_alpha));
+    return (rank < n) ? rank : n - 1;
+}
+
+//returns the byte offset inside the footprint for the given pattern
+uint64_t Workload::next_block(workload_pattern_t pattern){
+    uint64_t footprint_bytes = (footprint_mask + 1) << block_offset_bits;
+    uint64_t offset = 0;
+    switch (pattern)
+    {
+        case PATTERN_SEQUENTIAL:
+            offset = byte_offset;
+            byte_offset = (byte_offset + params.block_size) & (footprint_bytes - 1);
+            break;
+        case PATTERN_STRIDED:
+            offset = byte_offset;
+            byte_offset = (byte_offset + params.stride) & (footprint_bytes - 1);
+            break;
+        case PATTERN_RANDOM:
+            offset = (((next_random() >> 32) * (footprint_mask + 1)) >> 32) << block_offset_bits;
+            break;
+        case PATTERN_ZIPF:
+            offset = scatter(zipf_rank(next_random())) << block_offset_bits;
+            break;
+        case PATTERN_CHASE:
+            //full period LCG: every block is visited once per lap and each
+            //node depends on the previous one
+            chase_block = (chase_block * 6364136223846793005ull + 1442695040888963407ull) & footprint_mask;
+            offset = scatter(chase_block) << block_offset_bits;
+            break;
+        case PATTERN_MIXED:
+            break;
+    }
+    return offset;
+}
+
+bool Workload::next(uint32_t& addr, char& r_w){
+    if (generated == params.accesses) return false;
+
+    workload_pattern_t pattern = params.pattern;
+    if (pattern == PATTERN_MIXED)
+    {
+        pattern = mixed_phases[(generated / params.phase_length) % number_of_mixed_phases];
+    }
+    generated++;
+
+    r_w = ((uint32_t)next_random() < write_threshold) ? 'w' : 'r';
+    addr = params.base_addr + (uint32_t)next_block(pattern);
+    return true;
+}
+
+const char* Workload::get_description(){
+    snprintf(description, sizeof(description), "gen:%s,n=%" PRIu64 ",fp=%" PRIu64 ",stride=%u,wr=%g,seed=%" PRIu64 ",theta=%g,phase=%" PRIu64 ",base=0x%x",
+           pattern_names[params.pattern], params.accesses,
+           (footprint_mask + 1) << block_offset_bits, params.stride,
+           params.write_ratio, params.seed, params.theta, params.phase_length, params.base_addr);
+    return description;
+}
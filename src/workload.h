@@ -0,0 +1,79 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+//access patterns supported by the synthetic workload generator
+typedef enum
+{
+    PATTERN_SEQUENTIAL,  //walk the footprint one block at a time
+    PATTERN_STRIDED,     //walk the footprint with a fixed byte stride
+    PATTERN_RANDOM,      //uniform random block within the footprint
+    PATTERN_ZIPF,        //zipfian popularity, hot blocks scattered over the footprint
+    PATTERN_CHASE,       //dependent pointer chase visiting every block once per lap
+    PATTERN_MIXED        //rotate through all of the above every phase_length accesses
+} workload_pattern_t;
+
+//workload parameters parsed from "gen:<pattern>[,key=value]..."
+typedef struct
+{
+    workload_pattern_t pattern;
+    uint64_t accesses;      //n=     total number of requests to generate
+    uint64_t footprint;     //fp=    bytes touched, rounded up to a power of two blocks (K/M/G suffix allowed)
+    uint32_t stride;        //stride= byte stride for the strided pattern
+    double write_ratio;     //wr=    fraction of requests that are writes, 0..1
+    uint64_t seed;          //seed=  seed for the random number generator
+    double theta;           //theta= zipf skew, 0 < theta < 1
+    uint64_t phase_length;  //phase= accesses per phase for the mixed pattern
+    uint32_t base_addr;     //base=  address of the first byte of the footprint
+    uint32_t block_size;    //granularity of the generated addresses (BLOCKSIZE)
+} workload_params_t;
+
+//parse the trace argument as a workload spec
+//returns false if the argument is not a "gen:" spec or is malformed
+bool parse_workload_spec(const char*, uint32_t, workload_params_t*);
+
+class Workload {
+    private:
+        workload_params_t params;
+
+        //footprint in blocks = 2^footprint_bits
+        uint32_t block_offset_bits;
+        uint32_t footprint_bits;
+        uint64_t footprint_mask;  //mask on the block number
+
+        char description[256];
+        uint64_t generated;       //number of requests generated so far
+        uint64_t rng_state;       //splitmix64 state
+        uint32_t write_threshold; //low 32 random bits below this -> write
+
+        //state per pattern
+        uint64_t byte_offset;     //sequential/strided position inside the footprint
+        uint64_t chase_block;     //current node of the pointer chase
+
+        //zipf constants (Gray et al. "Quickly generating billion-record synthetic databases")
+        double zipf_zetan;
+        double zipf_alpha;
+        double zipf_eta;
+        double zipf_zeta2;
+
+        uint64_t next_random();
+        uint64_t scatter(uint64_t);
+        uint64_t zipf_rank(uint64_t);
+        uint64_t next_block(workload_pattern_t);
+
+    public:
+        //parameterized constructor
+        Workload(const workload_params_t&);
+
+        //produce the next request
+        //returns false once all the requested accesses are generated
+        bool next(uint32_t&, char&);
+
+        //description of the workload with all the defaults filled in
+        const char* get_description();
+};
+
+#endif